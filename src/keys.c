@@ -0,0 +1,319 @@
+/* nit is a brightness manager for keyboard and screen.
+   Copyright (C) 2017 Matteo Cellucci
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <linux/input.h>
+
+#include "keys.h"
+
+#define INPUT_PREFIX "event"
+#define EVENTS_LEN 64
+#define NOTIFY_LEN 4096
+
+/* Keys handled in listen mode with the controller and the direction of the
+   variation they trigger.  */
+struct key_binding
+{
+  int code;                   // key code.
+  enum controller_type type;  // controller adjusted by the key.
+  int direction;              // +1 to increase, -1 to decrease.
+};
+
+static struct key_binding const key_bindings[] =
+{
+  {KEY_BRIGHTNESSUP, screen, 1},
+  {KEY_BRIGHTNESSDOWN, screen, -1},
+  {KEY_KBDILLUMUP, keyboard, 1},
+  {KEY_KBDILLUMDOWN, keyboard, -1}
+};
+
+#define KEY_BINDINGS_LEN (sizeof (key_bindings) / sizeof (key_bindings[0]))
+
+static int add_device (struct keys_watch *watch, const char *name);
+static int scan_devices (struct keys_watch *watch);
+static int is_key_device (const int dd);
+
+int
+keys_watch_start (struct keys_watch *watch, const char *dir, const int ed)
+{
+  struct epoll_event event;
+
+  watch->dir = dir;
+  watch->ed = ed;
+  watch->devices = 0;
+
+  // watch before scanning, so that no device slips in between.
+  watch->id = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (watch->id >= 0)
+    {
+      event.events = EPOLLIN;
+      event.data.fd = watch->id;
+      if (inotify_add_watch (watch->id, dir,
+                             IN_CREATE | IN_ATTRIB | IN_MOVED_TO) < 0
+          || epoll_ctl (ed, EPOLL_CTL_ADD, watch->id, &event) < 0)
+        {
+          close (watch->id);
+          watch->id = -1;
+        }
+    }
+
+  scan_devices (watch);
+  return watch->id < 0 ? -1 : 0;
+}
+
+int
+keys_watch_update (struct keys_watch *watch)
+{
+  int added;
+  int rescan;
+  ssize_t notify_len;
+  struct inotify_event *event;
+  char notify[NOTIFY_LEN]
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+
+  added = 0;
+  rescan = 0;
+  while ((notify_len = read (watch->id, notify, sizeof (notify))) > 0)
+    {
+      for (char *p = notify; p < notify + notify_len;
+           p += sizeof (struct inotify_event) + event->len)
+        {
+          event = (struct inotify_event *) p;
+          if (event->mask & IN_Q_OVERFLOW)
+            {
+              rescan = 1;
+            }
+          else if (event->len > 0)
+            {
+              added += add_device (watch, event->name);
+            }
+        }
+    }
+
+  // some notifications were lost, look again at the whole folder.
+  if (rescan)
+    {
+      added += scan_devices (watch);
+    }
+  return added;
+}
+
+void
+keys_watch_remove (struct keys_watch *watch, const int dd)
+{
+  for (int i = 0; i < watch->devices; i++)
+    {
+      if (watch->dds[i] == dd)
+        {
+          watch->devices--;
+          watch->dds[i] = watch->dds[watch->devices];
+          watch->devs[i] = watch->devs[watch->devices];
+          watch->inos[i] = watch->inos[watch->devices];
+          break;
+        }
+    }
+  // a closed descriptor leaves the epoll set by itself.
+  close (dd);
+}
+
+void
+keys_watch_stop (struct keys_watch *watch)
+{
+  for (int i = 0; i < watch->devices; i++)
+    {
+      close (watch->dds[i]);
+    }
+  watch->devices = 0;
+  if (watch->id >= 0)
+    {
+      close (watch->id);
+      watch->id = -1;
+    }
+}
+
+int
+keys_read_events (const int dd, struct nit_controller **ctrls,
+                  const int *steps, int *bness, int *errors)
+{
+  int status;
+  int deltas[2];
+  ssize_t events_len;
+  struct input_event events[EVENTS_LEN];
+
+  deltas[screen] = 0;
+  deltas[keyboard] = 0;
+  while ((events_len = read (dd, events, sizeof (events))) > 0)
+    {
+      for (size_t i = 0; i < events_len / sizeof (struct input_event); i++)
+        {
+          // value is 1 for a press, 2 for a repeat and 0 for a release.
+          if (events[i].type != EV_KEY || events[i].value == 0)
+            {
+              continue;
+            }
+          for (unsigned int j = 0; j < KEY_BINDINGS_LEN; j++)
+            {
+              if (events[i].code == key_bindings[j].code)
+                {
+                  deltas[key_bindings[j].type] += key_bindings[j].direction
+                                                  * steps[key_bindings[j].type];
+                }
+            }
+        }
+    }
+
+  // checked before adjusting, which may overwrite errno. End of file means
+  // the writer of the stream is gone.
+  status = nit_ok;
+  if (events_len == 0
+      || (events_len < 0 && errno != EAGAIN && errno != EINTR))
+    {
+      status = keys_gone;
+    }
+
+  for (int i = screen; i <= keyboard; i++)
+    {
+      bness[i] = -1;
+      errors[i] = nit_ok;
+      if (ctrls[i] == NULL || deltas[i] == 0)
+        {
+          continue;
+        }
+      errors[i] = nit_refresh_adjust (ctrls[i], deltas[i], &bness[i]);
+    }
+
+  return status;
+}
+
+/* Watch the device NAME of the watched folder if it is an 'event*' device
+   reporting the brightness keys and it isn't watched yet. Return 1 if the
+   device was added, 0 otherwise.  */
+static int
+add_device (struct keys_watch *watch, const char *name)
+{
+  int dd;
+  char *device_path;
+  size_t device_path_len;
+  struct stat device_stat;
+  struct epoll_event event;
+
+  if (strncmp (name, INPUT_PREFIX, strlen (INPUT_PREFIX)) != 0
+      || watch->devices >= KEYS_MAX_DEVICES)
+    {
+      return 0;
+    }
+  device_path_len = strlen (watch->dir) + strlen (name) + strlen ("/") + 1;
+  device_path = malloc (device_path_len * sizeof (char));
+  if (device_path == NULL)
+    {
+      return 0;
+    }
+  snprintf (device_path, device_path_len * sizeof (char), "%s/%s",
+            watch->dir, name);
+  dd = open (device_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  free (device_path);
+  device_path = NULL;
+  if (dd < 0)
+    {
+      return 0;
+    }
+
+  // a device gets notified again when its permissions change.
+  if (fstat (dd, &device_stat) < 0 || !is_key_device (dd))
+    {
+      close (dd);
+      return 0;
+    }
+  for (int i = 0; i < watch->devices; i++)
+    {
+      if (watch->devs[i] == device_stat.st_dev
+          && watch->inos[i] == device_stat.st_ino)
+        {
+          close (dd);
+          return 0;
+        }
+    }
+
+  event.events = EPOLLIN;
+  event.data.fd = dd;
+  if (epoll_ctl (watch->ed, EPOLL_CTL_ADD, dd, &event) < 0)
+    {
+      close (dd);
+      return 0;
+    }
+  watch->dds[watch->devices] = dd;
+  watch->devs[watch->devices] = device_stat.st_dev;
+  watch->inos[watch->devices] = device_stat.st_ino;
+  watch->devices++;
+  return 1;
+}
+
+/* Add every device of the watched folder. Return the number of devices
+   added.  */
+static int
+scan_devices (struct keys_watch *watch)
+{
+  int added;
+  DIR *input_dir;
+  struct dirent *entry;
+
+  added = 0;
+  input_dir = opendir (watch->dir);
+  if (input_dir == NULL)
+    {
+      return added;
+    }
+  while ((entry = readdir (input_dir)) != NULL)
+    {
+      added += add_device (watch, entry->d_name);
+    }
+  closedir (input_dir);
+  return added;
+}
+
+/* Check whether the input device DD reports at least one of the bound
+   keys.  */
+static int
+is_key_device (const int dd)
+{
+  unsigned long keys[KEY_MAX / (8 * sizeof (unsigned long)) + 1];
+
+  memset (keys, 0, sizeof (keys));
+  if (ioctl (dd, EVIOCGBIT (EV_KEY, sizeof (keys)), keys) < 0)
+    {
+      return 0;
+    }
+  for (unsigned int i = 0; i < KEY_BINDINGS_LEN; i++)
+    {
+      int code = key_bindings[i].code;
+      if ((keys[code / (8 * sizeof (unsigned long))]
+           >> (code % (8 * sizeof (unsigned long)))) & 1)
+        {
+          return 1;
+        }
+    }
+  return 0;
+}
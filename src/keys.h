@@ -0,0 +1,85 @@
+/* nit is a brightness manager for keyboard and screen.
+   Copyright (C) 2017 Matteo Cellucci
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef KEYS_H
+#define KEYS_H
+
+#include <sys/types.h>
+
+#include "libnit.h"
+
+/* Maximum number of input devices watched at once.  */
+#define KEYS_MAX_DEVICES 32
+
+/* Types of controller, also indexes of the arrays of keys_read_events:
+     0 - screen controller;
+     1 - keyboard controller.  */
+enum controller_type
+{
+  screen,
+  keyboard
+};
+
+/* Status returned by keys_read_events besides nit_ok:
+     1 - the device is gone or the stream is closed.  */
+enum keys_status
+{
+  keys_gone = 1
+};
+
+/* Input devices reporting the brightness keys, kept in an epoll set
+   together with the notifications of their folder.  */
+struct keys_watch
+{
+  const char *dir;                // input folder.
+  int ed;                         // epoll set of the descriptors below.
+  int id;                         // notifications of the folder, or -1.
+  int devices;                    // number of watched devices.
+  int dds[KEYS_MAX_DEVICES];      // descriptors of the watched devices.
+  dev_t devs[KEYS_MAX_DEVICES];   // file systems of their nodes and
+  ino_t inos[KEYS_MAX_DEVICES];   // their inodes, to skip duplicates.
+};
+
+/* Add to the epoll set ED every 'event*' input device of DIR reporting at
+   least one of the brightness keys, and the notifications of DIR so that
+   devices appearing later can be added by keys_watch_update. Return 0, or -1
+   if DIR can't be watched for new devices; present devices are added
+   anyway.  */
+int keys_watch_start (struct keys_watch *watch, const char *dir,
+                      const int ed);
+
+/* Handle the pending notifications of the folder, once WATCH->id is ready,
+   adding the new devices reporting the brightness keys. Return the number
+   of devices added.  */
+int keys_watch_update (struct keys_watch *watch);
+
+/* Stop watching the device DD and close it.  */
+void keys_watch_remove (struct keys_watch *watch, const int dd);
+
+/* Close every descriptor of WATCH.  */
+void keys_watch_stop (struct keys_watch *watch);
+
+/* Drain pending events of the input device DD and apply the brightness keys
+   to CTRLS, moving by STEPS points per press or repeat. Presses and repeats of
+   a single batch are summed, so that each controller is written once per
+   call. BNESS receives the new brightness of each controller, or -1 if it
+   wasn't changed, and ERRORS the libnit status of its adjustment, so that a
+   failing controller doesn't hold back the other one. Return nit_ok or
+   keys_gone.  */
+int keys_read_events (const int dd, struct nit_controller **ctrls,
+                      const int *steps, int *bness, int *errors);
+
+#endif /* KEYS_H */
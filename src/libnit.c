@@ -0,0 +1,438 @@
+/* libnit is the brightness controller library behind nit.
+   Copyright (C) 2017 Matteo Cellucci
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+#include "libnit.h"
+
+/* Size of the buffer holding a brightness value as text.  */
+#define BNESS_VAL_LEN 16
+
+/* A controller manages the brightness of the associated device.  */
+struct nit_controller
+{
+  char *bness_path;      // path of the current brightness file.
+  int rd;                // read descriptor of the current brightness.
+  int cd;                // write descriptor, opened at the first change.
+  int truncate;          // the brightness file is not a sysfs attribute.
+  int current_bness;     // current brightness value.
+  int min_bness;         // minimum brightness value.
+  int max_bness;         // maximum brightness value.
+  pthread_mutex_t lock;  // serialize calls on the handle.
+};
+
+static char * controller_path (const char *dir, const char *name,
+                               const char *file);
+static int controller_get_bness (const int rd, int *bness);
+static int controller_refresh (struct nit_controller *ctrl);
+static int controller_open_write (struct nit_controller *ctrl);
+static int controller_set_bness (struct nit_controller *ctrl, int bness);
+static int controller_adjust_bness (struct nit_controller *ctrl, int delta);
+
+int
+nit_open (struct nit_controller **ctrl, const char *dir, const char *name)
+{
+  int md;
+  int error_flag;
+  char *max_bness_path;
+  struct nit_controller *c;
+
+  if (ctrl == NULL || dir == NULL || name == NULL)
+    {
+      return nit_invalid;
+    }
+  *ctrl = NULL;
+
+  c = malloc (sizeof (struct nit_controller));
+  if (c == NULL)
+    {
+      return nit_no_memory;
+    }
+  c->bness_path = controller_path (dir, name, "brightness");
+  max_bness_path = controller_path (dir, name, "max_brightness");
+  c->rd = -1;
+  c->cd = -1;
+  c->truncate = 0;
+  c->min_bness = 0;
+  if (c->bness_path == NULL || max_bness_path == NULL)
+    {
+      free (c->bness_path);
+      free (max_bness_path);
+      free (c);
+      return nit_no_memory;
+    }
+
+  // the maximum never changes, the current brightness is read again later.
+  error_flag = nit_no_controller;
+  md = open (max_bness_path, O_RDONLY);
+  free (max_bness_path);
+  if (md >= 0)
+    {
+      error_flag = controller_get_bness (md, &c->max_bness);
+      close (md);
+    }
+  if (error_flag == nit_ok)
+    {
+      c->rd = open (c->bness_path, O_RDONLY);
+      error_flag = c->rd < 0
+                   ? nit_no_controller
+                   : controller_get_bness (c->rd, &c->current_bness);
+    }
+  if (error_flag == nit_ok && pthread_mutex_init (&c->lock, NULL) != 0)
+    {
+      error_flag = nit_no_memory;
+    }
+  if (error_flag != nit_ok)
+    {
+      if (c->rd >= 0)
+        {
+          close (c->rd);
+        }
+      free (c->bness_path);
+      free (c);
+      return error_flag;
+    }
+
+  *ctrl = c;
+  return nit_ok;
+}
+
+int
+nit_get (struct nit_controller *ctrl, int *bness, int *min, int *max)
+{
+  int error_flag;
+
+  if (ctrl == NULL)
+    {
+      return nit_invalid;
+    }
+
+  pthread_mutex_lock (&ctrl->lock);
+  error_flag = controller_refresh (ctrl);
+  if (error_flag == nit_ok)
+    {
+      if (bness != NULL)
+        {
+          *bness = ctrl->current_bness;
+        }
+      if (min != NULL)
+        {
+          *min = ctrl->min_bness;
+        }
+      if (max != NULL)
+        {
+          *max = ctrl->max_bness;
+        }
+    }
+  pthread_mutex_unlock (&ctrl->lock);
+  return error_flag;
+}
+
+int
+nit_peek (struct nit_controller *ctrl, int *bness, int *min, int *max)
+{
+  if (ctrl == NULL)
+    {
+      return nit_invalid;
+    }
+
+  pthread_mutex_lock (&ctrl->lock);
+  if (bness != NULL)
+    {
+      *bness = ctrl->current_bness;
+    }
+  if (min != NULL)
+    {
+      *min = ctrl->min_bness;
+    }
+  if (max != NULL)
+    {
+      *max = ctrl->max_bness;
+    }
+  pthread_mutex_unlock (&ctrl->lock);
+  return nit_ok;
+}
+
+int
+nit_open_write (struct nit_controller *ctrl)
+{
+  int error_flag;
+
+  if (ctrl == NULL)
+    {
+      return nit_invalid;
+    }
+
+  pthread_mutex_lock (&ctrl->lock);
+  error_flag = controller_open_write (ctrl);
+  pthread_mutex_unlock (&ctrl->lock);
+  return error_flag;
+}
+
+int
+nit_set (struct nit_controller *ctrl, int bness, int *result)
+{
+  int error_flag;
+
+  if (ctrl == NULL)
+    {
+      return nit_invalid;
+    }
+
+  pthread_mutex_lock (&ctrl->lock);
+  error_flag = controller_set_bness (ctrl, bness);
+  if (error_flag == nit_ok && result != NULL)
+    {
+      *result = ctrl->current_bness;
+    }
+  pthread_mutex_unlock (&ctrl->lock);
+  return error_flag;
+}
+
+int
+nit_adjust (struct nit_controller *ctrl, int delta, int *result)
+{
+  int error_flag;
+
+  if (ctrl == NULL)
+    {
+      return nit_invalid;
+    }
+
+  pthread_mutex_lock (&ctrl->lock);
+  error_flag = controller_adjust_bness (ctrl, delta);
+  if (error_flag == nit_ok && result != NULL)
+    {
+      *result = ctrl->current_bness;
+    }
+  pthread_mutex_unlock (&ctrl->lock);
+  return error_flag;
+}
+
+int
+nit_refresh_adjust (struct nit_controller *ctrl, int delta, int *result)
+{
+  int error_flag;
+
+  if (ctrl == NULL)
+    {
+      return nit_invalid;
+    }
+
+  pthread_mutex_lock (&ctrl->lock);
+  error_flag = controller_refresh (ctrl);
+  if (error_flag == nit_ok)
+    {
+      error_flag = controller_adjust_bness (ctrl, delta);
+    }
+  if (error_flag == nit_ok && result != NULL)
+    {
+      *result = ctrl->current_bness;
+    }
+  pthread_mutex_unlock (&ctrl->lock);
+  return error_flag;
+}
+
+void
+nit_close (struct nit_controller *ctrl)
+{
+  if (ctrl == NULL)
+    {
+      return;
+    }
+  if (ctrl->cd >= 0)
+    {
+      close (ctrl->cd);
+    }
+  close (ctrl->rd);
+  pthread_mutex_destroy (&ctrl->lock);
+  free (ctrl->bness_path);
+  free (ctrl);
+}
+
+const char *
+nit_strerror (int status)
+{
+  switch (status)
+    {
+      case nit_ok:
+        return "success";
+      case nit_invalid:
+        return "invalid argument";
+      case nit_no_memory:
+        return "out of memory";
+      case nit_no_controller:
+        return "controller not found or permission denied";
+      case nit_read_failure:
+        return "unable to read current brightness";
+      case nit_write_failure:
+        return "unable to write new brightness";
+      default:
+        return "unknown error";
+    }
+}
+
+/* Build the path of FILE inside the controller NAME of DIR. Return NULL if
+   out of memory.  */
+static char *
+controller_path (const char *dir, const char *name, const char *file)
+{
+  char *path;
+  size_t path_len;
+
+  path_len = strlen (dir) + strlen (name) + strlen (file) + strlen ("//") + 1;
+  path = malloc (path_len * sizeof (char));
+  if (path == NULL)
+    {
+      return NULL;
+    }
+  snprintf (path, path_len * sizeof (char), "%s/%s/%s", dir, name, file);
+  return path;
+}
+
+/* Read the brightness value from the start of the descriptor RD, so that a
+   kept open descriptor costs a single read.  */
+static int
+controller_get_bness (const int rd, int *bness)
+{
+  ssize_t bness_val_len;
+  char bness_val[BNESS_VAL_LEN];
+
+  bness_val_len = pread (rd, bness_val, (BNESS_VAL_LEN - 1) * sizeof (char),
+                         0);
+  if (bness_val_len <= 0)
+    {
+      return nit_read_failure;
+    }
+  bness_val[bness_val_len] = '\0';
+
+  *bness = (int) strtol (bness_val, (char **) NULL, 10);
+  return nit_ok;
+}
+
+/* Read again the current brightness. If the read fails, e.g. because the
+   device was probed again, the descriptor is opened again once. Must be
+   called holding the lock.  */
+static int
+controller_refresh (struct nit_controller *ctrl)
+{
+  int rd;
+  int error_flag;
+
+  error_flag = controller_get_bness (ctrl->rd, &ctrl->current_bness);
+  if (error_flag != nit_ok)
+    {
+      rd = open (ctrl->bness_path, O_RDONLY);
+      if (rd < 0)
+        {
+          return nit_no_controller;
+        }
+      close (ctrl->rd);
+      ctrl->rd = rd;
+      error_flag = controller_get_bness (ctrl->rd, &ctrl->current_bness);
+    }
+  return error_flag;
+}
+
+/* Open the write descriptor, if not open yet. Must be called holding the
+   lock.  */
+static int
+controller_open_write (struct nit_controller *ctrl)
+{
+  struct statfs fs;
+
+  if (ctrl->cd >= 0)
+    {
+      return nit_ok;
+    }
+  ctrl->cd = open (ctrl->bness_path, O_WRONLY);
+  if (ctrl->cd < 0)
+    {
+      return nit_no_controller;
+    }
+  if (fstatfs (ctrl->cd, &fs) == 0 && fs.f_type != SYSFS_MAGIC)
+    {
+      ctrl->truncate = 1;
+    }
+  return nit_ok;
+}
+
+/* Make BNESS the active brightness, clamped between minimum and maximum. The
+   write descriptor is kept open so that following changes cost a single
+   write; files outside sysfs, which don't replace their content on each
+   write, are truncated too. After a failed write the descriptor is closed,
+   so the next change opens it again. Must be called holding the lock.  */
+static int
+controller_set_bness (struct nit_controller *ctrl, int bness)
+{
+  int error_flag;
+  int bness_val_len;
+  char bness_val[BNESS_VAL_LEN];
+
+  if (bness > ctrl->max_bness)
+    {
+      bness = ctrl->max_bness;
+    }
+  else if (bness < ctrl->min_bness)
+    {
+      bness = ctrl->min_bness;
+    }
+
+  error_flag = controller_open_write (ctrl);
+  if (error_flag != nit_ok)
+    {
+      return error_flag;
+    }
+
+  bness_val_len = snprintf (bness_val, BNESS_VAL_LEN * sizeof (char), "%d",
+                            bness);
+  if (pwrite (ctrl->cd, bness_val, bness_val_len * sizeof (char), 0) < 0
+      || (ctrl->truncate && ftruncate (ctrl->cd, bness_val_len) < 0))
+    {
+      close (ctrl->cd);
+      ctrl->cd = -1;
+      return nit_write_failure;
+    }
+
+  ctrl->current_bness = bness;
+  return nit_ok;
+}
+
+/* Add DELTA to the current brightness. Must be called holding the lock.  */
+static int
+controller_adjust_bness (struct nit_controller *ctrl, int delta)
+{
+  long long bness;
+
+  // long long is wider than int everywhere, so a huge delta can't overflow.
+  bness = (long long) ctrl->current_bness + delta;
+  if (bness > ctrl->max_bness)
+    {
+      bness = ctrl->max_bness;
+    }
+  else if (bness < ctrl->min_bness)
+    {
+      bness = ctrl->min_bness;
+    }
+  return controller_set_bness (ctrl, (int) bness);
+}
@@ -0,0 +1,93 @@
+/* libnit is the brightness controller library behind nit.
+   Copyright (C) 2017 Matteo Cellucci
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef LIBNIT_H
+#define LIBNIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default folders and names of the screen and keyboard controllers.  */
+#define NIT_SCREEN_DIR "/sys/class/backlight"
+#define NIT_SCREEN_NAME "nv_backlight"
+#define NIT_KEYBOARD_DIR "/sys/class/leds"
+#define NIT_KEYBOARD_NAME "smc::kbd_backlight"
+
+/* Return codes of the library calls. Errors are negative:
+      0 - successfully ended;
+     -1 - invalid argument (e.g. NULL handle);
+     -2 - out of memory;
+     -3 - controller not found or permission denied;
+     -4 - unable to read a brightness value;
+     -5 - unable to write the new brightness.  */
+enum nit_status
+{
+  nit_ok = 0,
+  nit_invalid = -1,
+  nit_no_memory = -2,
+  nit_no_controller = -3,
+  nit_read_failure = -4,
+  nit_write_failure = -5
+};
+
+/* Opaque handle of a controller. Calls on the same handle are serialized, so
+   a handle can be shared among threads.  */
+struct nit_controller;
+
+/* Open the controller NAME found in DIR and load its brightness values. On
+   success *CTRL points to a new handle that must be released with
+   nit_close. DIR/NAME is usually a sysfs controller, but any folder holding
+   the files 'brightness' and 'max_brightness' works, e.g. for testing.  */
+int nit_open (struct nit_controller **ctrl, const char *dir,
+              const char *name);
+
+/* Read again the current brightness from the controller. Any of BNESS, MIN
+   and MAX can be NULL.  */
+int nit_get (struct nit_controller *ctrl, int *bness, int *min, int *max);
+
+/* Get the brightness values last read or written through the handle,
+   without reading the controller. Any of BNESS, MIN and MAX can be NULL.  */
+int nit_peek (struct nit_controller *ctrl, int *bness, int *min, int *max);
+
+/* Open the controller for writing now instead of at the first change, so
+   that a missing write permission is reported early.  */
+int nit_open_write (struct nit_controller *ctrl);
+
+/* Set BNESS as current brightness, clamped between minimum and maximum. If
+   RESULT is not NULL it receives the value actually written.  */
+int nit_set (struct nit_controller *ctrl, int bness, int *result);
+
+/* Add DELTA to the last brightness read or written through the handle,
+   without reading the controller again. If RESULT is not NULL it receives
+   the value actually written.  */
+int nit_adjust (struct nit_controller *ctrl, int delta, int *result);
+
+/* Like nit_adjust, but read again the current brightness first, so that
+   changes made by other processes or by the firmware are not overwritten.  */
+int nit_refresh_adjust (struct nit_controller *ctrl, int delta, int *result);
+
+/* Release the handle and any resource held by it.  */
+void nit_close (struct nit_controller *ctrl);
+
+/* Describe a return code.  */
+const char * nit_strerror (int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBNIT_H */
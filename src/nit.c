@@ -24,6 +24,12 @@
 #include <ctype.h>
 #include <grp.h>
 #include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/epoll.h>
+
+#include "libnit.h"
+#include "keys.h"
 
 #define PROGRAM_NAME "nit"
 #define AUTHOR_NAME "Matteo Cellucci"
@@ -32,6 +38,9 @@
 #define RULES_DIR "/etc/udev/rules.d/99-nit.rules"
 #define SUBSYSTEM_NAME "backlight"
 #define ACTION_NAME "add"
+#define INPUT_DIR "/dev/input"
+#define MAX_EVENTS 8
+#define DEFAULT_STEPS 20
 
 /* Types of exit status:
      0 - successfully ended;
@@ -46,17 +55,6 @@ enum exit_status
   this_is_embarassing
 };
 
-/* Types of brightness with relatives files name:
-     0 - current brightness;
-     1 - minimum brightness;
-     2 - maximum brightness.  */
-enum bness_type
-{
-  current,
-  min,
-  max
-};
-
 /* Types of brightness variation:
      0 - no variations;
      1 - the variation must be added to the brightness;
@@ -70,23 +68,11 @@ enum bness_delta_type
   absolute
 };
 
-/* Types of controller:
-     0 - screen controller;
-     1 - keyboard controller.  */
-enum controller_type
-{
-  screen,
-  keyboard
-};
-
 /* A controller manages the brightness of the associated device.  */
 struct controller
 {
   char *dir;          // controller path.
   char *name;         // controller name.
-  int current_bness;  // current brightness value.
-  int min_bness;      // minimum brightness value.
-  int max_bness;      // maximum brightness value.
 };
 
 /* Current status of the process.  */
@@ -107,6 +93,13 @@ static int setup_mode;
 /* Print current controllers configuration (-l).  */
 static int print_controllers;
 
+/* Adjust brightness reading the brightness keys (--listen).  */
+static int listen_mode;
+
+/* Brightness variation of a key press (--step arg); 0 means a twentieth of
+   the controller range.  */
+static int bness_step;
+
 /* Active controller and controllers set:
      controllers[0] - screen controller (--screen);
      controllers[1] - keyboard controller (--keyboard).  */
@@ -114,17 +107,19 @@ static struct controller *controller;
 
 static struct controller controllers[] =
 {
-  {"/sys/class/backlight", "nv_backlight", 0, 0, 0},
-  {"/sys/class/leds", "smc::kbd_backlight", 0, 0, 0}
+  {NIT_SCREEN_DIR, NIT_SCREEN_NAME},
+  {NIT_KEYBOARD_DIR, NIT_KEYBOARD_NAME}
 };
 
-/* Option list: --screen, --keyboard and --setup have a pseudo short option in
-   order to complete the parsing.  */
+/* Option list: --screen, --keyboard, --setup, --listen and --step have a
+   pseudo short option in order to complete the parsing.  */
 enum pseudo_options
 {
   screen_opt,
   keyboard_opt,
-  setup_opt
+  setup_opt,
+  listen_opt,
+  step_opt
 };
 
 static struct option const long_options[] =
@@ -137,13 +132,14 @@ static struct option const long_options[] =
   {"silent-mode", no_argument, NULL, 'S'},
   {"screen", no_argument, NULL, screen_opt},
   {"keyboard", no_argument, NULL, keyboard_opt},
+  {"listen", no_argument, NULL, listen_opt},
+  {"step", required_argument, NULL, step_opt},
   {NULL, 0, NULL, 0}
 };
 
 static void parse_options (int argc, char *argv[]);
-static void controller_start ();
-static int controller_get_bness (const enum bness_type type);
-static void controller_set_bness ();
+static void controller_run ();
+static void listen_keys ();
 static void update_controllers ();
 static void list_controllers ();
 static void rules_setup ();
@@ -151,6 +147,7 @@ static char * generate_rule (const char *command,
                              const enum controller_type type);
 static void throw_error (const char *message, const enum exit_status code);
 static void check_failure (const int result, const char *message);
+static void report_error (const enum controller_type type, const int status);
 static void usage ();
 static void version ();
 
@@ -171,45 +168,11 @@ main (int argc, char *argv[])
     }
   if (controller != NULL)
     {
-      controller_start ();
-      
-      if (bness_delta_type == none)
-        {
-          printf ("%d/%d\n",
-                  controller->current_bness - controller->min_bness,
-                  controller->max_bness - controller->min_bness);
-        }
-      else
-        {
-          if (bness_delta_type == positive)
-            {
-              controller->current_bness += bness_delta_value;
-            }
-          else if (bness_delta_type == negative)
-            {
-              controller->current_bness -= bness_delta_value;
-            }
-          else
-            {
-              controller->current_bness = bness_delta_value;
-            }
-    
-          if (controller->current_bness > controller->max_bness)
-            {
-              controller->current_bness = controller->max_bness;
-            }
-          else if (controller->current_bness < controller->min_bness)
-            {
-              controller->current_bness = controller->min_bness;
-            }
-
-          controller_set_bness ();
-          
-          if (!silent_mode)
-            {
-              printf ("%d\n", controller->current_bness);
-            }
-        }
+      controller_run ();
+    }
+  if (listen_mode)
+    {
+      listen_keys ();
     }
 
   return exit_status;
@@ -224,12 +187,16 @@ parse_options (int argc, char *argv[])
 {
   /* optarg temp conteiner.  */
   char *oa = NULL;
+  /* --step arg before the range check.  */
+  long step_value;
 
   bness_delta_type = none;
   bness_delta_value = 0;
   silent_mode = 0;
   setup_mode = 0;
   print_controllers = 0;
+  listen_mode = 0;
+  bness_step = 0;
   controller = NULL;
   
   if (argc <= 1)
@@ -242,7 +209,7 @@ parse_options (int argc, char *argv[])
   while (1)
     {
       int oi = -1;
-      int c = getopt_long (argc, argv, "hvRlgs:", long_options, &oi);
+      int c = getopt_long (argc, argv, "hvRlgSs:", long_options, &oi);
       if (c == -1)
         {
           break;
@@ -299,6 +266,25 @@ parse_options (int argc, char *argv[])
           case keyboard_opt:
             controller = &controllers[keyboard];
             break;
+          case listen_opt:
+            listen_mode = 1;
+            break;
+          case step_opt:
+            for (unsigned int i = 0; i < strlen (optarg); i++)
+              {
+                if (!isdigit (optarg[i]))
+                  {
+                    throw_error ("invalid argument '--step'", misuse);
+                  }
+              }
+            errno = 0;
+            step_value = strtol (optarg, (char **)NULL, 10);
+            if (errno != 0 || step_value <= 0 || step_value > INT_MAX)
+              {
+                throw_error ("invalid argument '--step'", misuse);
+              }
+            bness_step = (int) step_value;
+            break;
           default:
             exit_status = misuse;
             usage ();
@@ -310,107 +296,163 @@ parse_options (int argc, char *argv[])
     {
       throw_error ("missing or unknow controller", misuse);
     }
+  if (bness_step != 0 && !listen_mode)
+    {
+      throw_error ("'--step' requires '--listen'", misuse);
+    }
 }
 
-/* Start the controller, initializing brightness values.  */
+/* Open the active controller, print or change its brightness and close
+   it.  */
 static void
-controller_start ()
+controller_run ()
 {
-  controller->min_bness = controller_get_bness (min);
-  controller->max_bness = controller_get_bness (max);
-  controller->current_bness = controller_get_bness (current);
+  int error_flag;
+  int bness;
+  int min_bness;
+  int max_bness;
+  struct nit_controller *ctrl;
+
+  error_flag = nit_open (&ctrl, controller->dir, controller->name);
+  check_failure (error_flag, nit_strerror (error_flag));
+  // nit_open has just loaded the values, don't read them again.
+  error_flag = nit_peek (ctrl, &bness, &min_bness, &max_bness);
+  if (error_flag == nit_ok)
+    {
+      if (bness_delta_type == none)
+        {
+          printf ("%d/%d\n", bness - min_bness, max_bness - min_bness);
+        }
+      else
+        {
+          if (bness_delta_type == positive)
+            {
+              error_flag = nit_adjust (ctrl, bness_delta_value, &bness);
+            }
+          else if (bness_delta_type == negative)
+            {
+              error_flag = nit_adjust (ctrl, -bness_delta_value, &bness);
+            }
+          else
+            {
+              error_flag = nit_set (ctrl, bness_delta_value, &bness);
+            }
+
+          if (error_flag == nit_ok && !silent_mode)
+            {
+              printf ("%d\n", bness);
+            }
+        }
+    }
+  nit_close (ctrl);
+  check_failure (error_flag, nit_strerror (error_flag));
 }
 
-/* Get a specific brightness value.  */
-static int
-controller_get_bness (const enum bness_type type)
+/* Open both controllers and adjust them on every brightness key event,
+   until the process is killed. Keys of a missing controller are ignored.
+   Input devices can come and go meanwhile.  */
+static void
+listen_keys ()
 {
-  int cd;
+  int ed;
+  int available;
   int error_flag;
-  char *bness_val;
-  char *bness_path;
-  char *bness_file;
-  size_t bness_val_len;
-  size_t bness_path_len;
-
-  bness_val_len = 4;
-  bness_path_len = strlen (controller->dir) + strlen (controller->name) + 1;
-  bness_val = malloc (bness_val_len * sizeof (char));
-  bness_path = NULL;
-  bness_file = NULL;
-
-  if (type == max)
+  int min_bness;
+  int max_bness;
+  int steps[2];
+  int bness[2];
+  int errors[2];
+  struct nit_controller *ctrls[2];
+  struct epoll_event events[MAX_EVENTS];
+  struct keys_watch watch;
+
+  available = 0;
+  for (int i = screen; i <= keyboard; i++)
     {
-      bness_file = "max_brightness";
+      ctrls[i] = NULL;
+      steps[i] = 0;
+      if (nit_open (&ctrls[i], controllers[i].dir, controllers[i].name)
+          != nit_ok)
+        {
+          continue;
+        }
+      // a controller that can't be written is ignored like a missing one.
+      error_flag = nit_open_write (ctrls[i]);
+      if (error_flag != nit_ok)
+        {
+          report_error (i, error_flag);
+          nit_close (ctrls[i]);
+          ctrls[i] = NULL;
+          continue;
+        }
+      error_flag = nit_peek (ctrls[i], NULL, &min_bness, &max_bness);
+      check_failure (error_flag, nit_strerror (error_flag));
+      steps[i] = bness_step;
+      if (steps[i] == 0)
+        {
+          steps[i] = (max_bness - min_bness) / DEFAULT_STEPS;
+        }
+      if (steps[i] < 1)
+        {
+          steps[i] = 1;
+        }
+      available++;
     }
-  else if (type == current)
+  if (available == 0)
     {
-      bness_file = "brightness";
+      throw_error ("controllers not found or permission denied", failure);
     }
-  else // if (type == min)
+
+  ed = epoll_create1 (EPOLL_CLOEXEC);
+  check_failure (ed, "unable to watch input devices");
+  if (keys_watch_start (&watch, INPUT_DIR, ed) < 0 && watch.devices == 0)
     {
-      free (bness_val);
-      return 0;
+      throw_error ("brightness keys not found or permission denied", failure);
+    }
+  if (watch.devices == 0)
+    {
+      fprintf (stderr, "%s: brightness keys not found yet, waiting for new "
+               "devices\n", PROGRAM_NAME);
     }
 
-  bness_path_len = bness_path_len + strlen ("//") + strlen (bness_file);
-  bness_path = malloc (bness_path_len * sizeof (char));
-  error_flag = snprintf (bness_path, bness_path_len * sizeof (char),
-                         "%s/%s/%s", controller->dir, controller->name,
-                         bness_file);
-  check_failure (error_flag, "unable to fetch controller's path");
-  
-  cd = open (bness_path, O_RDONLY, S_IRUSR | S_IRGRP);
-  check_failure (cd, "controller not found or permission denied");
-  error_flag = read (cd, bness_val, bness_val_len * sizeof (char));
-  check_failure (error_flag, "unable to read current brightness");
-  error_flag = close(cd);
-  check_failure (error_flag, "unable to read current brightness");
-
-  int bness_val_buffer = (int) strtol (bness_val, (char **) NULL, 10);
-  free (bness_val);
-  free (bness_path);
-  bness_val = NULL;
-  bness_path = NULL;
-  return bness_val_buffer;
-}
-
-/* Make the new brightness active.  */
-static void
-controller_set_bness ()
-{
-  int cd;
-  int error_flag;
-  char *bness_val;
-  char *bness_path;
-  size_t bness_val_len;
-  size_t bness_path_len;
-
-  bness_val_len = sizeof (int) + sizeof (char);
-  bness_path_len = strlen (controller->dir) + strlen (controller->name)
-                   + strlen ("//brightness") + 1;
-  bness_val = malloc (bness_val_len * sizeof (char));
-  bness_path = malloc (bness_path_len * sizeof (char));
-
-  error_flag = snprintf (bness_path, bness_path_len * sizeof (char),
-                         "%s/%s/brightness", controller->dir,
-                         controller->name);
-  check_failure (error_flag, "unable to fetch controller's path");
-  cd = open (bness_path, O_WRONLY, S_IWUSR | S_IWGRP);
-
-  check_failure (cd, "controller not found or permission denied");
-  error_flag = snprintf (bness_val, bness_val_len * sizeof (char), "%d",
-                         controller->current_bness);
-  check_failure (error_flag, "unable to fetch new brightness value");
-  error_flag = write (cd, bness_val, bness_val_len * sizeof (char));
-  check_failure (error_flag, "unable to write new brightness");
-  error_flag = close (cd);
-  check_failure (error_flag, "unable to write new brightness");
-
-  free (bness_val);
-  free (bness_path);
-  bness_val = NULL;
-  bness_path = NULL;
+  while (1)
+    {
+      int n = epoll_wait (ed, events, MAX_EVENTS, -1);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      check_failure (n, "unable to wait for key events");
+      for (int i = 0; i < n; i++)
+        {
+          if (events[i].data.fd == watch.id)
+            {
+              keys_watch_update (&watch);
+              continue;
+            }
+          error_flag = keys_read_events (events[i].data.fd, ctrls, steps,
+                                         bness, errors);
+          for (int j = screen; j <= keyboard; j++)
+            {
+              // a failed write may succeed at the next key press.
+              if (errors[j] != nit_ok)
+                {
+                  report_error (j, errors[j]);
+                }
+              else if (bness[j] >= 0 && !silent_mode)
+                {
+                  printf ("%s: %d\n", j == screen ? "Screen" : "Keyboard",
+                          bness[j]);
+                  fflush (stdout);
+                }
+            }
+          // the device may come back, e.g. after a resume.
+          if (error_flag == keys_gone)
+            {
+              keys_watch_remove (&watch, events[i].data.fd);
+            }
+        }
+    }
 }
 
 /* Load controllers paths from the environment.  */
@@ -608,6 +650,14 @@ throw_error (const char *message, const enum exit_status code)
   exit (exit_status);
 }
 
+/* Report a failure of a controller without exiting.  */
+static void
+report_error (const enum controller_type type, const int status)
+{
+  fprintf (stderr, "%s: %s controller: %s\n", PROGRAM_NAME,
+           type == screen ? "screen" : "keyboard", nit_strerror (status));
+}
+
 /* Check a result and throw an error if negative.  */
 static void
 check_failure (const int result, const char *message)
@@ -648,6 +698,11 @@ Option:\n\
 Device:\n\
   --screen               select screen controller\n\
   --keyboard             select keyboard controller\n\n\
+Listen:\n\
+  --listen               adjust brightness on brightness and keyboard\n\
+                         illumination key presses until killed; see KEYS\n\
+  --step=[VAL]           points added or subtracted by a key press; by\n\
+                         default a twentieth of the controller range\n\n\
 Controller:\n\
 By deafult controllers are 'nv_backlight' for the screen and\n\
 'smc::kbd_backlight' for the keyboard. Other controllers can be used setting\n\
@@ -660,6 +715,13 @@ In order to execute this command without root permission, you may need to add\n\
 rules in '/etc/udev/rules.d'. Once you configured the controllers, you can\n\
 generate these rules automatically with --setup and sudo permission. May be\n\
 necessary a logout/login or a reboot.\n\n\
+Keys:\n\
+With --listen the brightness keys are read from the devices in '/dev/input'\n\
+reporting them, so the user must be allowed to read those devices (usually\n\
+being in the 'input' group). Brightness keys adjust the screen controller and\n\
+keyboard illumination keys adjust the keyboard controller. Holding a key\n\
+repeats the variation. Devices plugged in later are watched too. Unless '-S'\n\
+is given, each change is printed as 'Screen: VAL' or 'Keyboard: VAL'.\n\n\
 Note:\n\
 To prevent unexpected issues brightness can never exceed minium value of 0\n\
 and maximum value stored in the file `max_brightness` of the controller\n\
@@ -0,0 +1,304 @@
+/* nit is a brightness manager for keyboard and screen.
+   Copyright (C) 2017 Matteo Cellucci
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Feed keys_read_events with a fake event stream written into a pipe and
+   check the brightness of two fake controllers living in a temp folder. The
+   watch of the input folder is checked on the same temp folder.  */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <linux/input.h>
+
+#include "libnit.h"
+#include "keys.h"
+
+#define TEST_NAME "keys_test"
+#define SCREEN_NAME "screen"
+#define KEYBOARD_NAME "keyboard"
+#define BROKEN_NAME "broken"
+
+#define CHECK(condition) check ((condition), #condition, __LINE__)
+
+/* Number of failed checks.  */
+static int failures;
+
+/* Number of brightness writes made by libnit, see __wrap_pwrite.  */
+static int writes;
+
+/* Temp folder of the fake controllers.  */
+static char dir[] = "/tmp/nit-test-XXXXXX";
+
+ssize_t __real_pwrite (int fd, const void *buf, size_t count, off_t offset);
+
+/* Count the writes of libnit, linked with --wrap=pwrite.  */
+ssize_t
+__wrap_pwrite (int fd, const void *buf, size_t count, off_t offset)
+{
+  writes++;
+  return __real_pwrite (fd, buf, count, offset);
+}
+
+/* Report a failed check.  */
+static void
+check (const int condition, const char *text, const int line)
+{
+  if (!condition)
+    {
+      fprintf (stderr, "%s:%d: check failed: %s\n", TEST_NAME, line, text);
+      failures++;
+    }
+}
+
+/* Write VALUE into the file FILE of the controller NAME.  */
+static void
+write_value (const char *name, const char *file, const int value)
+{
+  char path[256];
+  FILE *f;
+
+  snprintf (path, sizeof (path), "%s/%s/%s", dir, name, file);
+  f = fopen (path, "w");
+  fprintf (f, "%d\n", value);
+  fclose (f);
+}
+
+/* Read the current brightness of the controller NAME.  */
+static int
+read_value (const char *name)
+{
+  int value;
+  char path[256];
+  FILE *f;
+
+  snprintf (path, sizeof (path), "%s/%s/brightness", dir, name);
+  f = fopen (path, "r");
+  if (f == NULL || fscanf (f, "%d", &value) != 1)
+    {
+      value = -1;
+    }
+  if (f != NULL)
+    {
+      fclose (f);
+    }
+  return value;
+}
+
+/* Create the fake controller NAME.  */
+static void
+make_controller (const char *name, const int bness, const int max_bness)
+{
+  char path[256];
+
+  snprintf (path, sizeof (path), "%s/%s", dir, name);
+  mkdir (path, S_IRWXU);
+  write_value (name, "brightness", bness);
+  write_value (name, "max_brightness", max_bness);
+}
+
+/* Remove the fake controller NAME.  */
+static void
+remove_controller (const char *name)
+{
+  char path[256];
+
+  snprintf (path, sizeof (path), "%s/%s/brightness", dir, name);
+  unlink (path);
+  snprintf (path, sizeof (path), "%s/%s/max_brightness", dir, name);
+  unlink (path);
+  snprintf (path, sizeof (path), "%s/%s", dir, name);
+  rmdir (path);
+}
+
+/* Write an input event into the stream PD.  */
+static void
+send_event (const int pd, const int type, const int code, const int value)
+{
+  struct input_event event;
+
+  memset (&event, 0, sizeof (event));
+  event.type = type;
+  event.code = code;
+  event.value = value;
+  if (write (pd, &event, sizeof (event)) != sizeof (event))
+    {
+      fprintf (stderr, "%s: unable to write the event\n", TEST_NAME);
+      exit (EXIT_FAILURE);
+    }
+}
+
+int
+main ()
+{
+  int pds[2];
+  int steps[2];
+  int bness[2];
+  int errors[2];
+  int ed;
+  char path[256];
+  struct nit_controller *ctrls[2];
+  struct keys_watch watch;
+  struct epoll_event event;
+
+  if (mkdtemp (dir) == NULL || pipe2 (pds, O_NONBLOCK) < 0)
+    {
+      fprintf (stderr, "%s: unable to set up the fake devices\n", TEST_NAME);
+      return EXIT_FAILURE;
+    }
+  make_controller (SCREEN_NAME, 50, 100);
+  make_controller (KEYBOARD_NAME, 1, 3);
+  CHECK (nit_open (&ctrls[screen], dir, SCREEN_NAME) == nit_ok);
+  CHECK (nit_open (&ctrls[keyboard], dir, KEYBOARD_NAME) == nit_ok);
+  steps[screen] = 10;
+  steps[keyboard] = 1;
+
+  // a press moves by one step.
+  writes = 0;
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 1);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == 60);
+  CHECK (bness[keyboard] == -1);
+  CHECK (read_value (SCREEN_NAME) == 60);
+  CHECK (writes == 1);
+
+  // a repeat moves by one step too.
+  writes = 0;
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSDOWN, 2);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == 50);
+  CHECK (read_value (SCREEN_NAME) == 50);
+  CHECK (writes == 1);
+
+  // a release and events of other keys are ignored.
+  writes = 0;
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 0);
+  send_event (pds[1], EV_KEY, KEY_A, 1);
+  send_event (pds[1], EV_SYN, SYN_REPORT, 0);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == -1);
+  CHECK (bness[keyboard] == -1);
+  CHECK (read_value (SCREEN_NAME) == 50);
+  CHECK (writes == 0);
+
+  // a batch is summed into a single write.
+  writes = 0;
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 1);
+  send_event (pds[1], EV_SYN, SYN_REPORT, 0);
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 2);
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 2);
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 0);
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSDOWN, 1);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == 70);
+  CHECK (read_value (SCREEN_NAME) == 70);
+  CHECK (writes == 1);
+
+  // keyboard illumination keys only reach the keyboard controller.
+  writes = 0;
+  send_event (pds[1], EV_KEY, KEY_KBDILLUMUP, 1);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == -1);
+  CHECK (bness[keyboard] == 2);
+  CHECK (read_value (SCREEN_NAME) == 70);
+  CHECK (read_value (KEYBOARD_NAME) == 2);
+  CHECK (writes == 1);
+
+  // brightness is clamped at maximum and minimum.
+  send_event (pds[1], EV_KEY, KEY_KBDILLUMUP, 1);
+  send_event (pds[1], EV_KEY, KEY_KBDILLUMUP, 2);
+  send_event (pds[1], EV_KEY, KEY_KBDILLUMUP, 2);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[keyboard] == 3);
+  CHECK (read_value (KEYBOARD_NAME) == 3);
+  for (int i = 0; i < 10; i++)
+    {
+      send_event (pds[1], EV_KEY, KEY_BRIGHTNESSDOWN, 2);
+    }
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == 0);
+  CHECK (read_value (SCREEN_NAME) == 0);
+
+  // changes made by other writers are not overwritten.
+  write_value (SCREEN_NAME, "brightness", 30);
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 1);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == 40);
+  CHECK (read_value (SCREEN_NAME) == 40);
+
+  // a failing controller doesn't drop the batch of the other one.
+  nit_close (ctrls[keyboard]);
+  make_controller (BROKEN_NAME, 1, 3);
+  CHECK (nit_open (&ctrls[keyboard], dir, BROKEN_NAME) == nit_ok);
+  snprintf (path, sizeof (path), "%s/%s/brightness", dir, BROKEN_NAME);
+  unlink (path);
+  mkdir (path, S_IRWXU);
+  writes = 0;
+  send_event (pds[1], EV_KEY, KEY_KBDILLUMUP, 1);
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 1);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (errors[keyboard] == nit_no_controller);
+  CHECK (bness[keyboard] == -1);
+  CHECK (errors[screen] == nit_ok);
+  CHECK (bness[screen] == 50);
+  CHECK (read_value (SCREEN_NAME) == 50);
+  CHECK (writes == 1);
+  nit_close (ctrls[keyboard]);
+  rmdir (path);
+  remove_controller (BROKEN_NAME);
+
+  // keys of a missing controller are ignored.
+  ctrls[keyboard] = NULL;
+  send_event (pds[1], EV_KEY, KEY_KBDILLUMDOWN, 1);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[keyboard] == -1);
+  CHECK (read_value (KEYBOARD_NAME) == 3);
+
+  // a closed stream is reported as gone, after applying its last events.
+  send_event (pds[1], EV_KEY, KEY_BRIGHTNESSUP, 1);
+  close (pds[1]);
+  CHECK (keys_read_events (pds[0], ctrls, steps, bness, errors) == keys_gone);
+  CHECK (bness[screen] == 60);
+  close (pds[0]);
+
+  // new nodes of the watched folder are notified, and only devices
+  // reporting the brightness keys are added.
+  ed = epoll_create1 (EPOLL_CLOEXEC);
+  CHECK (keys_watch_start (&watch, dir, ed) == 0);
+  CHECK (watch.devices == 0);
+  snprintf (path, sizeof (path), "%s/event0", dir);
+  close (open (path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR));
+  CHECK (epoll_wait (ed, &event, 1, 1000) == 1);
+  CHECK (event.data.fd == watch.id);
+  CHECK (keys_watch_update (&watch) == 0);
+  CHECK (watch.devices == 0);
+  CHECK (epoll_wait (ed, &event, 1, 0) == 0);
+  keys_watch_stop (&watch);
+  close (ed);
+  unlink (path);
+
+  nit_close (ctrls[screen]);
+  remove_controller (SCREEN_NAME);
+  remove_controller (KEYBOARD_NAME);
+  rmdir (dir);
+
+  printf ("%s: %s\n", TEST_NAME, failures == 0 ? "passed" : "failed");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,200 @@
+/* nit is a brightness manager for keyboard and screen.
+   Copyright (C) 2017 Matteo Cellucci
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Exercise the libnit calls on a fake controller living in a temp
+   folder.  */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libnit.h"
+
+#define TEST_NAME "libnit_test"
+#define CTRL_NAME "screen"
+
+#define CHECK(condition) check ((condition), #condition, __LINE__)
+
+/* Number of failed checks.  */
+static int failures;
+
+/* Temp folder of the fake controller.  */
+static char dir[] = "/tmp/nit-test-XXXXXX";
+
+/* Report a failed check.  */
+static void
+check (const int condition, const char *text, const int line)
+{
+  if (!condition)
+    {
+      fprintf (stderr, "%s:%d: check failed: %s\n", TEST_NAME, line, text);
+      failures++;
+    }
+}
+
+/* Write VALUE into the file FILE of the controller NAME.  */
+static void
+write_value (const char *name, const char *file, const int value)
+{
+  char path[256];
+  FILE *f;
+
+  snprintf (path, sizeof (path), "%s/%s/%s", dir, name, file);
+  f = fopen (path, "w");
+  fprintf (f, "%d\n", value);
+  fclose (f);
+}
+
+/* Read the whole brightness file of the controller NAME into BUF.  */
+static void
+read_file (const char *name, char *buf, const size_t buf_len)
+{
+  char path[256];
+  size_t len;
+  FILE *f;
+
+  snprintf (path, sizeof (path), "%s/%s/brightness", dir, name);
+  len = 0;
+  f = fopen (path, "r");
+  if (f != NULL)
+    {
+      len = fread (buf, sizeof (char), buf_len - 1, f);
+      fclose (f);
+    }
+  buf[len] = '\0';
+}
+
+/* Create the fake controller NAME.  */
+static void
+make_controller (const char *name, const int bness, const int max_bness)
+{
+  char path[256];
+
+  snprintf (path, sizeof (path), "%s/%s", dir, name);
+  mkdir (path, S_IRWXU);
+  write_value (name, "brightness", bness);
+  write_value (name, "max_brightness", max_bness);
+}
+
+/* Remove the fake controller NAME.  */
+static void
+remove_controller (const char *name)
+{
+  char path[256];
+
+  snprintf (path, sizeof (path), "%s/%s/brightness", dir, name);
+  unlink (path);
+  snprintf (path, sizeof (path), "%s/%s/max_brightness", dir, name);
+  unlink (path);
+  snprintf (path, sizeof (path), "%s/%s", dir, name);
+  rmdir (path);
+}
+
+int
+main ()
+{
+  int bness;
+  int min_bness;
+  int max_bness;
+  char content[16];
+  char path[256];
+  struct nit_controller *ctrl;
+
+  if (mkdtemp (dir) == NULL)
+    {
+      fprintf (stderr, "%s: unable to set up the fake controller\n",
+               TEST_NAME);
+      return EXIT_FAILURE;
+    }
+  make_controller (CTRL_NAME, 50, 100);
+
+  // a missing controller can't be opened.
+  CHECK (nit_open (&ctrl, dir, "missing") == nit_no_controller);
+
+  // NULL handles and arguments are invalid.
+  CHECK (nit_open (NULL, dir, CTRL_NAME) == nit_invalid);
+  CHECK (nit_open (&ctrl, NULL, CTRL_NAME) == nit_invalid);
+  CHECK (nit_open (&ctrl, dir, NULL) == nit_invalid);
+  CHECK (nit_get (NULL, &bness, NULL, NULL) == nit_invalid);
+  CHECK (nit_peek (NULL, &bness, NULL, NULL) == nit_invalid);
+  CHECK (nit_set (NULL, 10, NULL) == nit_invalid);
+  CHECK (nit_adjust (NULL, 10, NULL) == nit_invalid);
+  CHECK (nit_refresh_adjust (NULL, 10, NULL) == nit_invalid);
+  CHECK (nit_open_write (NULL) == nit_invalid);
+  nit_close (NULL);
+
+  CHECK (nit_open (&ctrl, dir, CTRL_NAME) == nit_ok);
+  CHECK (nit_peek (ctrl, &bness, &min_bness, &max_bness) == nit_ok);
+  CHECK (bness == 50);
+  CHECK (min_bness == 0);
+  CHECK (max_bness == 100);
+
+  // set clamps at minimum and maximum.
+  CHECK (nit_set (ctrl, 250, &bness) == nit_ok);
+  CHECK (bness == 100);
+  CHECK (nit_set (ctrl, -20, &bness) == nit_ok);
+  CHECK (bness == 0);
+  CHECK (nit_set (ctrl, 42, &bness) == nit_ok);
+  CHECK (bness == 42);
+
+  // adjust clamps without overflowing on huge deltas.
+  CHECK (nit_adjust (ctrl, INT_MAX, &bness) == nit_ok);
+  CHECK (bness == 100);
+  CHECK (nit_adjust (ctrl, INT_MIN, &bness) == nit_ok);
+  CHECK (bness == 0);
+
+  // get picks up an external change, peek doesn't.
+  write_value (CTRL_NAME, "brightness", 70);
+  CHECK (nit_peek (ctrl, &bness, NULL, NULL) == nit_ok);
+  CHECK (bness == 0);
+  CHECK (nit_get (ctrl, &bness, NULL, NULL) == nit_ok);
+  CHECK (bness == 70);
+  CHECK (nit_peek (ctrl, &bness, NULL, NULL) == nit_ok);
+  CHECK (bness == 70);
+
+  // a shorter value leaves no stale digits.
+  CHECK (nit_set (ctrl, 100, NULL) == nit_ok);
+  CHECK (nit_set (ctrl, 5, NULL) == nit_ok);
+  read_file (CTRL_NAME, content, sizeof (content));
+  CHECK (strcmp (content, "5") == 0);
+
+  // a controller that can't be written is reported, and it is written again
+  // once it comes back.
+  CHECK (nit_open_write (ctrl) == nit_ok);
+  nit_close (ctrl);
+  CHECK (nit_open (&ctrl, dir, CTRL_NAME) == nit_ok);
+  snprintf (path, sizeof (path), "%s/%s/brightness", dir, CTRL_NAME);
+  unlink (path);
+  mkdir (path, S_IRWXU);
+  CHECK (nit_open_write (ctrl) == nit_no_controller);
+  CHECK (nit_set (ctrl, 20, NULL) == nit_no_controller);
+  rmdir (path);
+  write_value (CTRL_NAME, "brightness", 30);
+  CHECK (nit_set (ctrl, 20, NULL) == nit_ok);
+  read_file (CTRL_NAME, content, sizeof (content));
+  CHECK (strcmp (content, "20") == 0);
+
+  nit_close (ctrl);
+  remove_controller (CTRL_NAME);
+  rmdir (dir);
+
+  printf ("%s: %s\n", TEST_NAME, failures == 0 ? "passed" : "failed");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
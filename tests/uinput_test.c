@@ -0,0 +1,276 @@
+/* nit is a brightness manager for keyboard and screen.
+   Copyright (C) 2017 Matteo Cellucci
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Create a virtual keyboard through uinput while watching a folder with
+   keys_watch_start, find it when its node appears and press its brightness
+   keys. Skipped when '/dev/uinput' can't be opened.  */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/uinput.h>
+
+#include "libnit.h"
+#include "keys.h"
+
+#define TEST_NAME "uinput_test"
+#define UINPUT_PATH "/dev/uinput"
+#define INPUT_DIR "/dev/input"
+#define SYS_INPUT_DIR "/sys/class/input"
+#define SCREEN_NAME "screen"
+#define KEYBOARD_NAME "keyboard"
+#define WAIT_MS 1000
+
+#define CHECK(condition) check ((condition), #condition, __LINE__)
+
+/* Number of failed checks.  */
+static int failures;
+
+/* Temp folder of the fake controllers and of the device link.  */
+static char dir[] = "/tmp/nit-test-XXXXXX";
+
+/* Report a failed check.  */
+static void
+check (const int condition, const char *text, const int line)
+{
+  if (!condition)
+    {
+      fprintf (stderr, "%s:%d: check failed: %s\n", TEST_NAME, line, text);
+      failures++;
+    }
+}
+
+/* Create the fake controller NAME.  */
+static void
+make_controller (const char *name, const int bness, const int max_bness)
+{
+  char path[256];
+  FILE *f;
+
+  snprintf (path, sizeof (path), "%s/%s", dir, name);
+  mkdir (path, S_IRWXU);
+  snprintf (path, sizeof (path), "%s/%s/brightness", dir, name);
+  f = fopen (path, "w");
+  fprintf (f, "%d\n", bness);
+  fclose (f);
+  snprintf (path, sizeof (path), "%s/%s/max_brightness", dir, name);
+  f = fopen (path, "w");
+  fprintf (f, "%d\n", max_bness);
+  fclose (f);
+}
+
+/* Remove the fake controller NAME.  */
+static void
+remove_controller (const char *name)
+{
+  char path[256];
+
+  snprintf (path, sizeof (path), "%s/%s/brightness", dir, name);
+  unlink (path);
+  snprintf (path, sizeof (path), "%s/%s/max_brightness", dir, name);
+  unlink (path);
+  snprintf (path, sizeof (path), "%s/%s", dir, name);
+  rmdir (path);
+}
+
+/* Link into the temp folder the event node of the uinput device UD, so
+   that the watch sees only this device. Return 0 on success.  */
+static int
+link_device (const int ud)
+{
+  char sysname[64];
+  char path[256];
+  char node[PATH_MAX];
+  DIR *sys_dir;
+  struct dirent *entry;
+
+  if (ioctl (ud, UI_GET_SYSNAME (sizeof (sysname)), sysname) < 0)
+    {
+      return -1;
+    }
+  snprintf (path, sizeof (path), "%s/%s", SYS_INPUT_DIR, sysname);
+  sys_dir = opendir (path);
+  if (sys_dir == NULL)
+    {
+      return -1;
+    }
+  node[0] = '\0';
+  while ((entry = readdir (sys_dir)) != NULL)
+    {
+      if (strncmp (entry->d_name, "event", strlen ("event")) == 0)
+        {
+          snprintf (node, sizeof (node), "%s/%s", INPUT_DIR, entry->d_name);
+        }
+    }
+  closedir (sys_dir);
+  if (node[0] == '\0')
+    {
+      return -1;
+    }
+
+  // the node may need a while to show up.
+  for (int i = 0; i < WAIT_MS / 10 && access (node, R_OK) != 0; i++)
+    {
+      usleep (10000);
+    }
+  snprintf (path, sizeof (path), "%s/event0", dir);
+  return symlink (node, path);
+}
+
+/* Emit an input event through the uinput device UD.  */
+static void
+emit (const int ud, const int type, const int code, const int value)
+{
+  struct input_event event;
+
+  memset (&event, 0, sizeof (event));
+  event.type = type;
+  event.code = code;
+  event.value = value;
+  if (write (ud, &event, sizeof (event)) != sizeof (event))
+    {
+      fprintf (stderr, "%s: unable to emit the event\n", TEST_NAME);
+      exit (EXIT_FAILURE);
+    }
+}
+
+/* Wait for the key events of the devices of WATCH and apply them to
+   CTRLS.  */
+static int
+wait_events (struct keys_watch *watch, struct nit_controller **ctrls,
+             const int *steps, int *bness, int *errors)
+{
+  struct epoll_event event;
+
+  do
+    {
+      if (epoll_wait (watch->ed, &event, 1, WAIT_MS) != 1)
+        {
+          return -1;
+        }
+      if (event.data.fd == watch->id)
+        {
+          keys_watch_update (watch);
+        }
+    }
+  while (event.data.fd == watch->id);
+  return keys_read_events (event.data.fd, ctrls, steps, bness, errors);
+}
+
+int
+main ()
+{
+  int ud;
+  int ed;
+  int steps[2];
+  int bness[2];
+  int errors[2];
+  char path[256];
+  struct nit_controller *ctrls[2];
+  struct uinput_setup setup;
+  struct keys_watch watch;
+  struct epoll_event event;
+
+  ud = open (UINPUT_PATH, O_WRONLY | O_NONBLOCK);
+  if (ud < 0)
+    {
+      printf ("%s: skipped, unable to open %s\n", TEST_NAME, UINPUT_PATH);
+      return EXIT_SUCCESS;
+    }
+  ed = epoll_create1 (EPOLL_CLOEXEC);
+  if (mkdtemp (dir) == NULL || ed < 0)
+    {
+      fprintf (stderr, "%s: unable to set up the fake devices\n", TEST_NAME);
+      return EXIT_FAILURE;
+    }
+
+  // start from an empty folder, the device shows up later.
+  CHECK (keys_watch_start (&watch, dir, ed) == 0);
+  CHECK (watch.devices == 0);
+
+  memset (&setup, 0, sizeof (setup));
+  setup.id.bustype = BUS_VIRTUAL;
+  strncpy (setup.name, "nit test keyboard", UINPUT_MAX_NAME_SIZE - 1);
+  if (ioctl (ud, UI_SET_EVBIT, EV_KEY) < 0
+      || ioctl (ud, UI_SET_KEYBIT, KEY_BRIGHTNESSUP) < 0
+      || ioctl (ud, UI_SET_KEYBIT, KEY_BRIGHTNESSDOWN) < 0
+      || ioctl (ud, UI_SET_KEYBIT, KEY_KBDILLUMUP) < 0
+      || ioctl (ud, UI_SET_KEYBIT, KEY_KBDILLUMDOWN) < 0
+      || ioctl (ud, UI_DEV_SETUP, &setup) < 0
+      || ioctl (ud, UI_DEV_CREATE) < 0
+      || link_device (ud) < 0)
+    {
+      printf ("%s: skipped, unable to create the uinput device\n", TEST_NAME);
+      keys_watch_stop (&watch);
+      close (ed);
+      close (ud);
+      snprintf (path, sizeof (path), "%s/event0", dir);
+      unlink (path);
+      rmdir (dir);
+      return EXIT_SUCCESS;
+    }
+
+  make_controller (SCREEN_NAME, 50, 100);
+  make_controller (KEYBOARD_NAME, 1, 3);
+  CHECK (nit_open (&ctrls[screen], dir, SCREEN_NAME) == nit_ok);
+  CHECK (nit_open (&ctrls[keyboard], dir, KEYBOARD_NAME) == nit_ok);
+  steps[screen] = 10;
+  steps[keyboard] = 1;
+
+  CHECK (epoll_wait (ed, &event, 1, WAIT_MS) == 1);
+  CHECK (event.data.fd == watch.id);
+  CHECK (keys_watch_update (&watch) == 1);
+  CHECK (watch.devices == 1);
+
+  emit (ud, EV_KEY, KEY_BRIGHTNESSUP, 1);
+  emit (ud, EV_SYN, SYN_REPORT, 0);
+  emit (ud, EV_KEY, KEY_BRIGHTNESSUP, 0);
+  emit (ud, EV_SYN, SYN_REPORT, 0);
+  CHECK (wait_events (&watch, ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == 60);
+  CHECK (bness[keyboard] == -1);
+
+  emit (ud, EV_KEY, KEY_KBDILLUMDOWN, 1);
+  emit (ud, EV_SYN, SYN_REPORT, 0);
+  emit (ud, EV_KEY, KEY_KBDILLUMDOWN, 0);
+  emit (ud, EV_SYN, SYN_REPORT, 0);
+  CHECK (wait_events (&watch, ctrls, steps, bness, errors) == nit_ok);
+  CHECK (bness[screen] == -1);
+  CHECK (bness[keyboard] == 0);
+
+  ioctl (ud, UI_DEV_DESTROY);
+  close (ud);
+  keys_watch_stop (&watch);
+  close (ed);
+  nit_close (ctrls[screen]);
+  nit_close (ctrls[keyboard]);
+  remove_controller (SCREEN_NAME);
+  remove_controller (KEYBOARD_NAME);
+  snprintf (path, sizeof (path), "%s/event0", dir);
+  unlink (path);
+  rmdir (dir);
+
+  printf ("%s: %s\n", TEST_NAME, failures == 0 ? "passed" : "failed");
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}